@@ -1,9 +1,21 @@
 #include <raylib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <math.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+
+// Worker threads: pthreads where available, C11 threads on MSVC. Without either the
+// pool is compiled out and every job runs on the main thread when it is waited on.
+#if defined(_MSC_VER) && !defined(__STDC_NO_THREADS__)
+#include <threads.h>
+#define SCHED_C11_THREADS
+#elif !defined(_MSC_VER)
+#include <pthread.h>
+#define SCHED_PTHREADS
+#endif
 
 
 #define BOARD_SIZE 8
@@ -13,6 +25,19 @@
 #define MAX_SCORE_POPUPS 32
 #define MAX_PARTICLES 256
 
+#define SIM_DT (1.0f / 60.0f) // Fixed simulation step
+#define MAX_SIM_STEPS 4 // Max simulation steps per rendered frame
+#define GARBAGE_TILE 'X' // Blocker sent by the opponent, never matches
+
+#define ROLLBACK_WINDOW 8 // Max frames we run ahead of the remote player
+#define ROLLBACK_RING (ROLLBACK_WINDOW + 1)
+#define LOOPBACK_CAPACITY 64
+#define VERSUS_LATENCY 4 // Artificial one-way delay of the loopback link, in frames
+
+#define SCHED_WORKERS 3 // Worker threads next to the main thread
+#define SCHED_MAX_JOBS 32 // Jobs per frame
+#define SCHED_MAX_DEPENDENTS 4
+
 typedef struct {
     Vector2 position;
     Vector2 velocity;
@@ -27,30 +52,180 @@ void spawn_particles(int x, int y, Vector2 grid_origin);
 void update_particles(float dt);
 void draw_particles(void);
 
-bool find_hint(Vector2 *);
-
 const char tile_chars[TILE_TYPES] = {'#', '@', '$', '%', '&'};
 
-char board[BOARD_SIZE][BOARD_SIZE];
-bool matched[BOARD_SIZE][BOARD_SIZE] = { 0 }; // To track matched tiles
-float fall_offset[BOARD_SIZE][BOARD_SIZE] = { 0 }; // To track falling tiles
-
 
 typedef enum {
-    STATE_INTRO, // Added intro state
 	STATE_IDLE,
 	STATE_ANIMATING,
 	STATE_MATCH_DELAY,
 	STATE_SWAPPING
 } TileState;
 
+typedef enum {
+	MODE_INTRO,
+	MODE_SOLO,
+	MODE_VERSUS
+} GameMode;
+
+// One frame of input for one player
+typedef struct {
+	signed char x, y; // Clicked tile, -1 if no click this frame
+} PlayerInput;
+
+const PlayerInput no_input = { -1, -1 };
+
+// Everything the simulation reads or writes. Plain data, so a snapshot is a copy.
+typedef struct {
+	char tiles[BOARD_SIZE][BOARD_SIZE];
+	bool matched[BOARD_SIZE][BOARD_SIZE]; // To track matched tiles
+	float fall_offset[BOARD_SIZE][BOARD_SIZE]; // To track falling tiles
+	TileState state;
+	Vector2 selected_tile; // To track the selected tile position
+	Vector2 swap_from;
+	Vector2 swap_to;
+	float swap_progress;
+	float match_delay_timer; // Timer for match delay
+	bool wrong_move;
+	float wrong_move_timer;
+	Vector2 wrong_move_from;
+	Vector2 wrong_move_to;
+	int score;
+	int chain; // Match waves in the current cascade, 0 when not player-triggered
+	int garbage_out; // Garbage earned this step, picked up by the opponent
+	int garbage_in; // Garbage waiting to drop once the board is idle
+	uint32_t rng;
+	Vector2 origin;
+} GameBoard;
+
+typedef struct {
+	GameBoard boards[2];
+} VersusState;
+
+typedef struct {
+	int frame;
+	PlayerInput input;
+	int deliver_at; // Link tick at which the packet becomes visible
+} InputPacket;
+
+// In-process stand-in for a network link, delivers packets in order after a fixed delay
+typedef struct {
+	InputPacket packets[LOOPBACK_CAPACITY];
+	int head;
+	int count;
+	int latency;
+	int now;
+} LoopbackChannel;
+
+typedef struct {
+	VersusState state; // State at the start of `frame`, possibly built on predictions
+	VersusState snapshots[ROLLBACK_RING]; // State at the start of each recent frame
+	PlayerInput inputs[ROLLBACK_RING][2]; // Inputs used for each recent frame
+	int frame; // Next frame to simulate
+	int remote_frame; // Last frame with a confirmed remote input
+	int rollback_from; // Earliest mispredicted frame, -1 if none
+	int local; // Board this peer controls
+	LoopbackChannel *send;
+	LoopbackChannel *recv;
+	int rollbacks;
+	int resimulated; // Frames resimulated by the last rollback
+} RollbackSession;
+
+bool find_hint_horizontal(char board[BOARD_SIZE][BOARD_SIZE], Vector2 out_tiles[2]);
+bool find_hint_vertical(char board[BOARD_SIZE][BOARD_SIZE], Vector2 out_tiles[2]);
+
+typedef void (*JobFn)(void *arg);
+typedef int JobHandle; // Index into the frame's jobs, -1 for a job that already ran
+
+typedef struct {
+	JobFn fn;
+	void *arg;
+	int waiting_on; // Unfinished dependencies
+	JobHandle dependents[SCHED_MAX_DEPENDENTS];
+	int dependent_count;
+	bool done;
+} Job;
+
+#if defined(SCHED_C11_THREADS)
+typedef thrd_t SchedThread;
+typedef mtx_t SchedMutex;
+typedef cnd_t SchedCond;
+#define sched_mutex_init(m) mtx_init(m, mtx_plain)
+#define sched_mutex_destroy(m) mtx_destroy(m)
+#define sched_lock(m) mtx_lock(m)
+#define sched_unlock(m) mtx_unlock(m)
+#define sched_cond_init(c) cnd_init(c)
+#define sched_cond_destroy(c) cnd_destroy(c)
+#define sched_cond_wait(c, m) cnd_wait(c, m)
+#define sched_cond_signal(c) cnd_signal(c)
+#define sched_cond_broadcast(c) cnd_broadcast(c)
+#elif defined(SCHED_PTHREADS)
+typedef pthread_t SchedThread;
+typedef pthread_mutex_t SchedMutex;
+typedef pthread_cond_t SchedCond;
+#define sched_mutex_init(m) pthread_mutex_init(m, NULL)
+#define sched_mutex_destroy(m) pthread_mutex_destroy(m)
+#define sched_lock(m) pthread_mutex_lock(m)
+#define sched_unlock(m) pthread_mutex_unlock(m)
+#define sched_cond_init(c) pthread_cond_init(c, NULL)
+#define sched_cond_destroy(c) pthread_cond_destroy(c)
+#define sched_cond_wait(c, m) pthread_cond_wait(c, m)
+#define sched_cond_signal(c) pthread_cond_signal(c)
+#define sched_cond_broadcast(c) pthread_cond_broadcast(c)
+#else
+// Single-threaded: nothing to lock, and nobody else could wake a waiter
+typedef int SchedThread;
+typedef int SchedMutex;
+typedef int SchedCond;
+#define sched_mutex_init(m) ((void)(m))
+#define sched_mutex_destroy(m) ((void)(m))
+#define sched_lock(m) ((void)(m))
+#define sched_unlock(m) ((void)(m))
+#define sched_cond_init(c) ((void)(c))
+#define sched_cond_destroy(c) ((void)(c))
+#define sched_cond_wait(c, m) ((void)(c), (void)(m))
+#define sched_cond_signal(c) ((void)(c))
+#define sched_cond_broadcast(c) ((void)(c))
+#endif
+
+// Fixed worker pool running one job graph per frame
+typedef struct {
+	SchedThread workers[SCHED_WORKERS];
+	int worker_count;
+	SchedMutex lock;
+	SchedCond job_ready;
+	SchedCond job_done;
+	Job jobs[SCHED_MAX_JOBS];
+	int job_count;
+	JobHandle ready[SCHED_MAX_JOBS]; // Jobs whose dependencies are done, in FIFO order
+	int ready_head;
+	int ready_tail;
+	int pending; // Jobs of this frame not finished yet
+	bool quit;
+} Scheduler;
+
+Scheduler scheduler;
+void wait_job(Scheduler *s, JobHandle h);
+
+// Private board copy for the background hint search, which swaps tiles in place
+typedef struct {
+	char tiles[BOARD_SIZE][BOARD_SIZE];
+	Vector2 found_tiles[2];
+	bool found;
+} HintSearch;
+
+HintSearch hint_searches[2]; // Horizontal and vertical swaps, searched in parallel
+
+GameMode game_mode;
+GameBoard player; // Solo board
 
-TileState tile_state;
-TileState post_intro_state; // Store the state after init_board
+RollbackSession peers[2]; // Both ends of the local versus match
+LoopbackChannel links[2]; // links[i] carries peer i's inputs to the other peer
+bool desync = false;
+
+// Effects (sound, popups, particles) are off while resimulating or running the remote peer
+bool sim_effects = true;
 
-Vector2 swap_from = {-1, -1};
-Vector2 swap_to = {-1, -1};
-float swap_progress = 0.0f;
 const float SWAP_DURATION = 0.15f; // Duration in seconds
 
 typedef struct {
@@ -63,14 +238,10 @@ typedef struct {
 
 ScorePopup score_popups[MAX_SCORE_POPUPS] = { 0 };
 
-int score = 0;
 int high_score = 0;
-Vector2 grid_origin;
 Texture2D background;
 Font score_font;
-Vector2 selected_tile = { -1, -1 }; // To track the selected tile position
-float fall_speed = 8.0f; // Speed of falling tiles
-float match_delay_timer = 0.0f; // Timer for match delay
+const float fall_speed = 8.0f; // Speed of falling tiles, per simulation step
 const float MATCH_DELAY_DURATION = 0.2f; // Delay before resolving matches
 
 float score_scale = 1.0f;
@@ -81,17 +252,13 @@ bool score_animating = false;
 
 // Hint system variables
 float idle_timer = 0.0f;
-const float HINT_IDLE_DURATION = 15.0f; 
+const float HINT_IDLE_DURATION = 15.0f;
 bool hint_active = false;
 Vector2 hint_tiles[3] = { {-1, -1}, {-1, -1}, {-1, -1} };
 
 
 // Wrong move warning variables
-bool wrong_move = false;
-float wrong_move_timer = 0.0f;
 const float WRONG_MOVE_DURATION = 0.3f;
-Vector2 wrong_move_from = {-1, -1};
-Vector2 wrong_move_to = {-1, -1};
 
 bool music_on = true;
 
@@ -100,15 +267,31 @@ Music background_music;
 Sound match_sound;
 
 
-char random_tile() {
-    return tile_chars[rand() % TILE_TYPES];
+// xorshift32, so a board replays identically from its seed
+uint32_t rng_next(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+
+char random_tile(GameBoard *b) {
+    return tile_chars[rng_next(&b->rng) % TILE_TYPES];
+}
+
+
+bool is_matchable(char t) {
+	return t != ' ' && t != GARBAGE_TILE;
 }
 
 
-void swap_tiles(int x1, int y1, int x2, int y2){
-	char temp = board[y1][x1];
-	board[y1][x1] = board[y2][x2];
-	board[y2][x2] = temp;
+void swap_tiles(GameBoard *b, int x1, int y1, int x2, int y2){
+	char temp = b->tiles[y1][x1];
+	b->tiles[y1][x1] = b->tiles[y2][x2];
+	b->tiles[y2][x2] = temp;
 }
 
 
@@ -133,66 +316,82 @@ void add_score_popup(int x, int y, int amount, Vector2 grid_origin){
 	}
 }
 
-bool find_matches(){
-	bool found = false;
+void match_effects(GameBoard *b, int x, int y){
+	if (!sim_effects) return;
+	PlaySound(match_sound);
+	score_animating = true;
+	score_scale = 2.0f;
+	score_scale_velocity = -2.5f;
+	add_score_popup(x, y, 10, b->origin);
+	spawn_particles(x, y, b->origin); // spawn particles for match
+}
+
+// Returns the number of lines matched
+int find_matches(GameBoard *b){
+	int lines = 0;
 	for (int y = 0; y < BOARD_SIZE; y++) {
 		for (int x = 0; x < BOARD_SIZE; x++){
-			matched[y][x] = false; // Reset matched status
+			b->matched[y][x] = false; // Reset matched status
 		}
 	}
 
 	for (int y = 0; y < BOARD_SIZE; y++){
 		for(int x = 0; x < BOARD_SIZE - 2; x++){
-			char t = board[y][x];
-			if( t == board[y][x + 1] &&
-				 t == board[y][x + 2]){
-				matched[y][x] = matched[y][x + 1] = matched[y][x + 2] = true;
+			char t = b->tiles[y][x];
+			if( is_matchable(t) &&
+				 t == b->tiles[y][x + 1] &&
+				 t == b->tiles[y][x + 2]){
+				b->matched[y][x] = b->matched[y][x + 1] = b->matched[y][x + 2] = true;
 				// update score
-				score += 10;
-				found = true;
-				PlaySound(match_sound);
-				score_animating = true;
-				score_scale = 2.0f;
-				score_scale_velocity = -2.5f;
-				add_score_popup(x, y, 10, grid_origin);
-				spawn_particles(x, y, grid_origin); // spawn particles for match
+				b->score += 10;
+				lines++;
+				match_effects(b, x, y);
 			}
 		}
 	}
 
 	for (int x = 0; x < BOARD_SIZE; x++){
 		for(int y = 0; y < BOARD_SIZE - 2; y++){
-			char t = board[y][x];
-			if( t == board[y + 1][x] &&
-				 t == board[y + 2][x]){
-				matched[y][x] = matched[y + 1][x] = matched[y + 2][x] = true;
+			char t = b->tiles[y][x];
+			if( is_matchable(t) &&
+				 t == b->tiles[y + 1][x] &&
+				 t == b->tiles[y + 2][x]){
+				b->matched[y][x] = b->matched[y + 1][x] = b->matched[y + 2][x] = true;
 				// update score
-				score += 10;
-				found = true;
-				PlaySound(match_sound);
-				score_animating = true;
-				score_scale = 2.0f;
-				score_scale_velocity = -2.5f;
-				add_score_popup(x, y, 10, grid_origin);
-				spawn_particles(x, y, grid_origin); // spawn particles for match
+				b->score += 10;
+				lines++;
+				match_effects(b, x, y);
 			}
 		}
 	}
 
-	return found;
-	
+	// Garbage next to a match is cleared with it
+	for (int y = 0; y < BOARD_SIZE; y++){
+		for (int x = 0; x < BOARD_SIZE; x++){
+			if (b->tiles[y][x] != GARBAGE_TILE) continue;
+			if ((x > 0 && b->matched[y][x - 1] && b->tiles[y][x - 1] != GARBAGE_TILE) ||
+				(x < BOARD_SIZE - 1 && b->matched[y][x + 1] && b->tiles[y][x + 1] != GARBAGE_TILE) ||
+				(y > 0 && b->matched[y - 1][x] && b->tiles[y - 1][x] != GARBAGE_TILE) ||
+				(y < BOARD_SIZE - 1 && b->matched[y + 1][x] && b->tiles[y + 1][x] != GARBAGE_TILE)) {
+				b->matched[y][x] = true;
+			}
+		}
+	}
+
+	return lines;
+
 }
 
 
-void resolve_matches(){
+void resolve_matches(GameBoard *b){
 	for (int x = 0; x < BOARD_SIZE; x++){
 		int write_y = BOARD_SIZE - 1; // Start from the bottom
 		for(int y = BOARD_SIZE - 1; y >= 0; y--){
-			if(!matched[y][x]){
+			if(!b->matched[y][x]){
 				if(y != write_y){
-					board[write_y][x] = board[y][x]; // Move non-matched tiles down
-					fall_offset[write_y][x] = (write_y - y) * TILE_SIZE; // Set fall offset
-					board[y][x] = ' '; // Clear the original position
+					b->tiles[write_y][x] = b->tiles[y][x]; // Move non-matched tiles down
+					b->fall_offset[write_y][x] = (write_y - y) * TILE_SIZE; // Set fall offset
+					b->tiles[y][x] = ' '; // Clear the original position
 				}
 				write_y--;
 			}
@@ -200,40 +399,397 @@ void resolve_matches(){
 
 		// Fill the remaining tiles with random tiles
 		while(write_y >= 0){
-			board[write_y][x] = random_tile();
-			fall_offset[write_y][x] = (write_y + 1) * TILE_SIZE; // Set fall offset for new tiles
+			b->tiles[write_y][x] = random_tile(b);
+			b->fall_offset[write_y][x] = (write_y + 1) * TILE_SIZE; // Set fall offset for new tiles
 			write_y--;
 		}
 	}
 
 
-	 tile_state = STATE_ANIMATING; // Set state to animating
+	 b->state = STATE_ANIMATING; // Set state to animating
 
 }
 
 
+// Turn pending garbage into blockers at random free positions
+void drop_garbage(GameBoard *b){
+	int free_cells = 0;
+	for (int y = 0; y < BOARD_SIZE; y++){
+		for (int x = 0; x < BOARD_SIZE; x++){
+			if (b->tiles[y][x] != GARBAGE_TILE) free_cells++;
+		}
+	}
+
+	for (int i = 0; i < b->garbage_in && free_cells > 0; i++){
+		int x, y;
+		do {
+			x = rng_next(&b->rng) % BOARD_SIZE;
+			y = rng_next(&b->rng) % BOARD_SIZE;
+		} while (b->tiles[y][x] == GARBAGE_TILE); // Re-roll so no blocker is lost
+		b->tiles[y][x] = GARBAGE_TILE;
+		free_cells--;
+	}
+	b->garbage_in = 0;
+}
+
+
+
+void init_board(GameBoard *b, uint32_t seed, Vector2 origin){
+	*b = (GameBoard){ 0 };
+	b->rng = seed ? seed : 0x9E3779B9u; // xorshift never leaves zero
+	b->origin = origin;
+	b->selected_tile = b->swap_from = b->swap_to = (Vector2){-1, -1};
+	b->wrong_move_from = b->wrong_move_to = (Vector2){-1, -1};
 
-void init_board(){
     for (int y = 0; y < BOARD_SIZE; y++) {
         for (int x = 0; x < BOARD_SIZE; x++) {
-            board[y][x] = random_tile();
+            b->tiles[y][x] = random_tile(b);
         }
     }
 
-    int grid_width = BOARD_SIZE * TILE_SIZE;
-    int grid_height = BOARD_SIZE * TILE_SIZE;
+	if (find_matches(b)){
+		resolve_matches(b);
+	} else {
+		b->state = STATE_IDLE;
+	}
+}
 
-    grid_origin = (Vector2){
-        (GetScreenWidth() - grid_width) / 2,
-        (GetScreenHeight() - grid_height) / 2
-    };
 
+// Advance one board by exactly SIM_DT. Depends only on the board and the input.
+void step_board(GameBoard *b, PlayerInput input){
+	if (b->state == STATE_IDLE && input.x >= 0) {
+		Vector2 current_tile = (Vector2){ input.x, input.y };
+		if (b->selected_tile.x < 0) {
+			b->selected_tile = current_tile;
+		}
+		else {
+			if (are_tiles_adjacent(b->selected_tile, current_tile)) {
+				b->swap_from = b->selected_tile;
+				b->swap_to = current_tile;
+				b->swap_progress = 0.0f;
+				b->state = STATE_SWAPPING;
+			}
+			b->selected_tile = (Vector2){-1, -1};
+		}
+	}
 
-	if (find_matches()){
-		resolve_matches();
-	} else {
-		tile_state = STATE_IDLE;
+	// Handle swap animation
+	if (b->state == STATE_SWAPPING) {
+		b->swap_progress += SIM_DT / SWAP_DURATION;
+		if (b->swap_progress >= 1.0f) {
+			swap_tiles(b, b->swap_from.x, b->swap_from.y, b->swap_to.x, b->swap_to.y);
+			if (find_matches(b)) {
+				b->chain = 1;
+				resolve_matches(b);
+			} else {
+				swap_tiles(b, b->swap_from.x, b->swap_from.y, b->swap_to.x, b->swap_to.y); // Swap back if no match
+				// Set wrong move warning
+				b->wrong_move = true;
+				b->wrong_move_timer = WRONG_MOVE_DURATION;
+				b->wrong_move_from = b->swap_from;
+				b->wrong_move_to = b->swap_to;
+				b->state = STATE_IDLE;
+			}
+			b->swap_from = b->swap_to = (Vector2){-1, -1};
+		}
+	}
+
+	// Wrong move
+	if (b->wrong_move) {
+		b->wrong_move_timer -= SIM_DT;
+		if (b->wrong_move_timer <= 0.0f) {
+			b->wrong_move = false;
+		}
+	}
+
+	if (b->state == STATE_ANIMATING) {
+		bool still_animating = false;
+		for (int y = 0; y < BOARD_SIZE; y++){
+			for (int x = 0; x < BOARD_SIZE; x++){
+				if (b->fall_offset[y][x] > 0){
+					b->fall_offset[y][x] -= fall_speed; // Decrease fall offset
+					if (b->fall_offset[y][x] < 0) {
+						b->fall_offset[y][x] = 0; // Reset to zero if it falls below
+					} else {
+						still_animating = true; // Still animating
+					}
+				}
+			}
+		}
+
+		if (!still_animating) {
+			b->state = STATE_MATCH_DELAY; // Move to match delay state
+			b->match_delay_timer = MATCH_DELAY_DURATION;
+		}
+	}
+
+	if (b->state == STATE_MATCH_DELAY) {
+		b->match_delay_timer -= SIM_DT;
+		if (b->match_delay_timer <= 0) {
+			int lines = find_matches(b);
+			if (lines) {
+				// Cascades after the player's own match attack the opponent
+				if (b->chain > 0) {
+					b->garbage_out += lines;
+					b->chain++;
+				}
+				resolve_matches(b);
+			} else {
+				b->chain = 0;
+				b->state = STATE_IDLE; // Go back to idle state if no matches found
+			}
+		}
+	}
+
+	if (b->state == STATE_IDLE && b->garbage_in > 0) {
+		drop_garbage(b);
+	}
+}
+
+
+void init_versus(VersusState *v, uint32_t seed){
+	int grid_size = BOARD_SIZE * TILE_SIZE;
+	float y = (GetScreenHeight() - grid_size) / 2 + 20;
+	init_board(&v->boards[0], seed, (Vector2){ 40, y });
+	init_board(&v->boards[1], seed * 2654435761u + 1, (Vector2){ GetScreenWidth() - 40 - grid_size, y });
+}
+
+void step_versus(VersusState *v, const PlayerInput inputs[2]){
+	step_board(&v->boards[0], inputs[0]);
+	step_board(&v->boards[1], inputs[1]);
+
+	// Exchange garbage only after both boards stepped, so the order of the two steps doesn't matter
+	int sent0 = v->boards[0].garbage_out;
+	int sent1 = v->boards[1].garbage_out;
+	v->boards[0].garbage_out = v->boards[1].garbage_out = 0;
+	v->boards[0].garbage_in += sent1;
+	v->boards[1].garbage_in += sent0;
+}
+
+uint32_t fnv_bytes(uint32_t h, const void *data, size_t size){
+	const unsigned char *p = data;
+	for (size_t i = 0; i < size; i++) {
+		h = (h ^ p[i]) * 16777619u;
+	}
+	return h;
+}
+
+// FNV-1a over every field that drives later frames. Field by field, since struct padding is garbage.
+uint32_t versus_checksum(const VersusState *v){
+	uint32_t h = 2166136261u;
+	for (int i = 0; i < 2; i++){
+		const GameBoard *b = &v->boards[i];
+		h = fnv_bytes(h, b->tiles, sizeof(b->tiles));
+		h = fnv_bytes(h, b->matched, sizeof(b->matched));
+		h = fnv_bytes(h, b->fall_offset, sizeof(b->fall_offset));
+		h = fnv_bytes(h, &b->state, sizeof(b->state));
+		h = fnv_bytes(h, &b->selected_tile, sizeof(b->selected_tile));
+		h = fnv_bytes(h, &b->swap_from, sizeof(b->swap_from));
+		h = fnv_bytes(h, &b->swap_to, sizeof(b->swap_to));
+		h = fnv_bytes(h, &b->swap_progress, sizeof(b->swap_progress));
+		h = fnv_bytes(h, &b->match_delay_timer, sizeof(b->match_delay_timer));
+		h = fnv_bytes(h, &b->wrong_move, sizeof(b->wrong_move));
+		h = fnv_bytes(h, &b->wrong_move_timer, sizeof(b->wrong_move_timer));
+		h = fnv_bytes(h, &b->wrong_move_from, sizeof(b->wrong_move_from));
+		h = fnv_bytes(h, &b->wrong_move_to, sizeof(b->wrong_move_to));
+		h = fnv_bytes(h, &b->score, sizeof(b->score));
+		h = fnv_bytes(h, &b->chain, sizeof(b->chain));
+		h = fnv_bytes(h, &b->garbage_out, sizeof(b->garbage_out));
+		h = fnv_bytes(h, &b->garbage_in, sizeof(b->garbage_in));
+		h = fnv_bytes(h, &b->rng, sizeof(b->rng));
+	}
+	return h;
+}
+
+
+void loopback_init(LoopbackChannel *ch, int latency){
+	*ch = (LoopbackChannel){ 0 };
+	ch->latency = latency;
+}
+
+// Advance the link clock by one frame
+void loopback_tick(LoopbackChannel *ch){
+	ch->now++;
+}
+
+bool loopback_full(const LoopbackChannel *ch){
+	return ch->count == LOOPBACK_CAPACITY;
+}
+
+bool loopback_send(LoopbackChannel *ch, int frame, PlayerInput input){
+	if (loopback_full(ch)) return false;
+	int tail = (ch->head + ch->count) % LOOPBACK_CAPACITY;
+	ch->packets[tail] = (InputPacket){ frame, input, ch->now + ch->latency };
+	ch->count++;
+	return true;
+}
+
+// Look at the oldest packet that has arrived, without removing it
+bool loopback_peek(const LoopbackChannel *ch, InputPacket *out){
+	if (ch->count == 0 || ch->packets[ch->head].deliver_at > ch->now) return false;
+	*out = ch->packets[ch->head];
+	return true;
+}
+
+void loopback_pop(LoopbackChannel *ch){
+	ch->head = (ch->head + 1) % LOOPBACK_CAPACITY;
+	ch->count--;
+}
+
+
+void rollback_init(RollbackSession *s, const VersusState *initial, int local, LoopbackChannel *send, LoopbackChannel *recv){
+	*s = (RollbackSession){ 0 };
+	s->state = *initial;
+	s->remote_frame = -1;
+	s->rollback_from = -1;
+	s->local = local;
+	s->send = send;
+	s->recv = recv;
+}
+
+// Simulate one frame with the local input, predicting the remote one if it hasn't
+// arrived. Rewinds and resimulates first if an earlier prediction was wrong.
+// Returns false (and simulates nothing) when too far ahead of the remote player
+// or when the link can't take this frame's input.
+bool rollback_advance(RollbackSession *s, PlayerInput local_input){
+	int remote = 1 - s->local;
+
+	// Take every remote input up to the frame we are about to simulate
+	InputPacket packet;
+	while (loopback_peek(s->recv, &packet) && packet.frame <= s->frame) {
+		loopback_pop(s->recv);
+		PlayerInput *slot = &s->inputs[packet.frame % ROLLBACK_RING][remote];
+		if (packet.frame < s->frame &&
+			(slot->x != packet.input.x || slot->y != packet.input.y) &&
+			(s->rollback_from < 0 || packet.frame < s->rollback_from)) {
+			s->rollback_from = packet.frame;
+		}
+		*slot = packet.input;
+		s->remote_frame = packet.frame;
+	}
+
+	if (s->rollback_from >= 0) {
+		bool effects = sim_effects;
+		sim_effects = false;
+		s->state = s->snapshots[s->rollback_from % ROLLBACK_RING];
+		for (int f = s->rollback_from; f < s->frame; f++) {
+			s->snapshots[f % ROLLBACK_RING] = s->state;
+			step_versus(&s->state, s->inputs[f % ROLLBACK_RING]);
+		}
+		sim_effects = effects;
+		s->resimulated = s->frame - s->rollback_from;
+		s->rollbacks++;
+		s->rollback_from = -1;
+	}
+
+	if (s->frame - s->remote_frame > ROLLBACK_WINDOW) return false;
+	// A lost input would stall the remote player for good, so wait for room instead
+	if (loopback_full(s->send)) return false;
+
+	int slot = s->frame % ROLLBACK_RING;
+	s->inputs[slot][s->local] = local_input;
+	if (s->remote_frame < s->frame) {
+		// Clicks are one-off events, so "no click" is the best guess
+		s->inputs[slot][remote] = no_input;
 	}
+	s->snapshots[slot] = s->state;
+	loopback_send(s->send, s->frame, local_input);
+	step_versus(&s->state, s->inputs[slot]);
+	s->frame++;
+	return true;
+}
+
+// Checksum of the state at the start of `frame`, if every input before it is confirmed
+bool rollback_confirmed_checksum(const RollbackSession *s, int frame, uint32_t *out){
+	if (frame > s->remote_frame + 1 || frame > s->frame || frame < s->frame - ROLLBACK_WINDOW) return false;
+	*out = versus_checksum(frame == s->frame ? &s->state : &s->snapshots[frame % ROLLBACK_RING]);
+	return true;
+}
+
+void start_versus(uint32_t seed){
+	VersusState initial;
+	bool effects = sim_effects;
+	sim_effects = false;
+	init_versus(&initial, seed);
+	sim_effects = effects;
+
+	loopback_init(&links[0], VERSUS_LATENCY);
+	loopback_init(&links[1], VERSUS_LATENCY);
+	rollback_init(&peers[0], &initial, 0, &links[0], &links[1]);
+	rollback_init(&peers[1], &initial, 1, &links[1], &links[0]);
+	desync = false;
+}
+
+PlayerInput scripted_input(const PlayerInput *script, int frames, int frame, int player){
+	return frame < frames ? script[frame * 2 + player] : no_input;
+}
+
+// Headless check of the rollback layer (run with --test-versus). Plays scripted random
+// clicks through both peers over the delayed loopback links, with one peer skipping ticks
+// now and then so the other also stalls. Every confirmed frame must checksum the same on
+// both peers and match a plain lockstep run of the same inputs.
+int test_versus(int trials, int frames){
+	PlayerInput *script = malloc(sizeof(PlayerInput) * frames * 2);
+	if (!script) return 1;
+	sim_effects = false;
+
+	int failures = 0;
+	for (int trial = 0; trial < trials; trial++) {
+		srand(trial + 1);
+		for (int i = 0; i < frames * 2; i++) {
+			script[i] = rand() % 6 == 0 ? (PlayerInput){ rand() % BOARD_SIZE, rand() % BOARD_SIZE } : no_input;
+		}
+
+		uint32_t seed = trial * 2654435761u + 1;
+		VersusState reference;
+		init_versus(&reference, seed);
+		int reference_frame = 0;
+		start_versus(seed);
+
+		int checked = 0;
+		bool failed = false;
+		for (int tick = 0; !failed && tick < frames * 3 && (peers[0].frame < frames || peers[1].frame < frames); tick++) {
+			loopback_tick(&links[0]);
+			loopback_tick(&links[1]);
+			for (int p = 0; p < 2; p++) {
+				if (p == trial % 2 && tick % 3 == 0) continue; // Slow peer alternates between trials
+				rollback_advance(&peers[p], scripted_input(script, frames, peers[p].frame, p));
+			}
+
+			int confirmed = (peers[0].remote_frame < peers[1].remote_frame ? peers[0].remote_frame : peers[1].remote_frame) + 1;
+			while (reference_frame < confirmed) {
+				PlayerInput inputs[2] = {
+					scripted_input(script, frames, reference_frame, 0),
+					scripted_input(script, frames, reference_frame, 1)
+				};
+				step_versus(&reference, inputs);
+				reference_frame++;
+			}
+
+			uint32_t sum0, sum1;
+			if (rollback_confirmed_checksum(&peers[0], confirmed, &sum0) &&
+				rollback_confirmed_checksum(&peers[1], confirmed, &sum1)) {
+				uint32_t expected = versus_checksum(&reference);
+				if (sum0 != sum1 || sum0 != expected) {
+					printf("trial %d: frame %d checksums %08x/%08x, lockstep %08x\n", trial, confirmed, sum0, sum1, expected);
+					failed = true;
+				}
+				checked++;
+			}
+		}
+
+		if (!failed && (peers[0].frame < frames || peers[1].frame < frames || checked == 0)) {
+			printf("trial %d: stuck at frames %d/%d after %d checks\n", trial, peers[0].frame, peers[1].frame, checked);
+			failed = true;
+		}
+		if (failed) failures++;
+		else printf("trial %d: ok, %d checks, %d/%d rollbacks\n", trial, checked, peers[0].rollbacks, peers[1].rollbacks);
+	}
+
+	free(script);
+	sim_effects = true;
+	printf("%d/%d trials passed\n", trials - failures, trials);
+	return failures ? 1 : 0;
 }
 
 // High score file path
@@ -259,10 +815,381 @@ void save_high_score() {
     }
 }
 
+
+// Pop the next ready job and run it. Called with the lock held, drops it while the job runs.
+void run_ready_job(Scheduler *s){
+	JobHandle h = s->ready[s->ready_head++];
+	Job *job = &s->jobs[h];
+	sched_unlock(&s->lock);
+	job->fn(job->arg);
+	sched_lock(&s->lock);
+
+	job->done = true;
+	s->pending--;
+	for (int i = 0; i < job->dependent_count; i++) {
+		Job *next = &s->jobs[job->dependents[i]];
+		if (--next->waiting_on == 0) {
+			s->ready[s->ready_tail++] = job->dependents[i];
+			sched_cond_signal(&s->job_ready);
+		}
+	}
+	sched_cond_broadcast(&s->job_done);
+}
+
+void scheduler_worker(Scheduler *s){
+	sched_lock(&s->lock);
+	while (!s->quit) {
+		if (s->ready_head == s->ready_tail) {
+			sched_cond_wait(&s->job_ready, &s->lock);
+		} else {
+			run_ready_job(s);
+		}
+	}
+	sched_unlock(&s->lock);
+}
+
+#if defined(SCHED_C11_THREADS)
+int scheduler_thread_main(void *arg){
+	scheduler_worker(arg);
+	return 0;
+}
+
+bool start_worker(SchedThread *thread, Scheduler *s){
+	return thrd_create(thread, scheduler_thread_main, s) == thrd_success;
+}
+
+void join_worker(SchedThread thread){
+	thrd_join(thread, NULL);
+}
+#elif defined(SCHED_PTHREADS)
+void *scheduler_thread_main(void *arg){
+	scheduler_worker(arg);
+	return NULL;
+}
+
+bool start_worker(SchedThread *thread, Scheduler *s){
+	return pthread_create(thread, NULL, scheduler_thread_main, s) == 0;
+}
+
+void join_worker(SchedThread thread){
+	pthread_join(thread, NULL);
+}
+#else
+bool start_worker(SchedThread *thread, Scheduler *s){
+	(void)thread;
+	(void)s;
+	return false;
+}
+
+void join_worker(SchedThread thread){
+	(void)thread;
+}
+#endif
+
+void scheduler_init(Scheduler *s){
+	*s = (Scheduler){ 0 };
+	sched_mutex_init(&s->lock);
+	sched_cond_init(&s->job_ready);
+	sched_cond_init(&s->job_done);
+	// Without workers every job simply runs on the main thread when waited on
+	for (int i = 0; i < SCHED_WORKERS; i++) {
+		if (start_worker(&s->workers[s->worker_count], s)) {
+			s->worker_count++;
+		}
+	}
+}
+
+// Add a job to this frame's graph. It starts once all of `deps` have finished.
+// Jobs are scheduled from the main thread only.
+JobHandle schedule_job(Scheduler *s, JobFn fn, void *arg, const JobHandle *deps, int dep_count){
+	sched_lock(&s->lock);
+	// A dependency with no room to notify us is waited on before the job exists
+	for (int i = 0; i < dep_count; i++) {
+		if (deps[i] >= 0 && !s->jobs[deps[i]].done &&
+			s->jobs[deps[i]].dependent_count == SCHED_MAX_DEPENDENTS) {
+			sched_unlock(&s->lock);
+			wait_job(s, deps[i]);
+			sched_lock(&s->lock);
+		}
+	}
+
+	if (s->job_count == SCHED_MAX_JOBS) {
+		// Graph is full, finish the dependencies and run it right here
+		sched_unlock(&s->lock);
+		for (int i = 0; i < dep_count; i++) wait_job(s, deps[i]);
+		fn(arg);
+		return -1;
+	}
+
+	// Registered without dropping the lock, so no dependency can finish halfway
+	JobHandle h = s->job_count++;
+	s->jobs[h] = (Job){ .fn = fn, .arg = arg };
+	s->pending++;
+	for (int i = 0; i < dep_count; i++) {
+		if (deps[i] < 0 || s->jobs[deps[i]].done) continue;
+		Job *dep = &s->jobs[deps[i]];
+		dep->dependents[dep->dependent_count++] = h;
+		s->jobs[h].waiting_on++;
+	}
+	if (s->jobs[h].waiting_on == 0) {
+		s->ready[s->ready_tail++] = h;
+		sched_cond_signal(&s->job_ready);
+	}
+	sched_unlock(&s->lock);
+	return h;
+}
+
+// Block until a job has finished, running ready jobs on this thread in the meantime
+void wait_job(Scheduler *s, JobHandle h){
+	if (h < 0) return;
+	sched_lock(&s->lock);
+	while (!s->jobs[h].done) {
+		if (s->ready_head != s->ready_tail) {
+			run_ready_job(s);
+		} else {
+			sched_cond_wait(&s->job_done, &s->lock);
+		}
+	}
+	sched_unlock(&s->lock);
+}
+
+// Wait for every job of this frame and start an empty graph for the next one
+void finish_frame(Scheduler *s){
+	sched_lock(&s->lock);
+	while (s->pending > 0) {
+		if (s->ready_head != s->ready_tail) {
+			run_ready_job(s);
+		} else {
+			sched_cond_wait(&s->job_done, &s->lock);
+		}
+	}
+	s->job_count = 0;
+	s->ready_head = s->ready_tail = 0;
+	sched_unlock(&s->lock);
+}
+
+void scheduler_shutdown(Scheduler *s){
+	finish_frame(s);
+	sched_lock(&s->lock);
+	s->quit = true;
+	sched_cond_broadcast(&s->job_ready);
+	sched_unlock(&s->lock);
+	for (int i = 0; i < s->worker_count; i++) {
+		join_worker(s->workers[i]);
+	}
+	sched_cond_destroy(&s->job_ready);
+	sched_cond_destroy(&s->job_done);
+	sched_mutex_destroy(&s->lock);
+}
+
+
+#define TEST_SCHED_FANOUT (SCHED_MAX_DEPENDENTS + 2)
+#define TEST_SCHED_JOBS (SCHED_MAX_JOBS + 8)
+
+typedef struct {
+	int runs;
+	int stamp; // Position in the order jobs ran this frame
+} TestJob;
+
+SchedMutex test_job_lock;
+int test_job_clock;
+
+void test_job(void *arg){
+	TestJob *t = arg;
+	sched_lock(&test_job_lock);
+	t->runs++;
+	t->stamp = test_job_clock++;
+	sched_unlock(&test_job_lock);
+}
+
+// Headless check of the scheduler (run with --test-scheduler). Each frame builds
+// a, b -> c -> TEST_SCHED_FANOUT chained jobs, more than c has room to notify, then chains
+// the rest one after another past SCHED_MAX_JOBS. Every job must run exactly once,
+// after all of its dependencies.
+int test_scheduler(int frames){
+	TestJob jobs[TEST_SCHED_JOBS];
+	const int a = 0, b = 1, c = 2, fanout = 3, chain = fanout + TEST_SCHED_FANOUT;
+	sched_mutex_init(&test_job_lock);
+	scheduler_init(&scheduler);
+	printf("%d workers\n", scheduler.worker_count);
+
+	int failures = 0;
+	for (int frame = 0; frame < frames && failures < 10; frame++) {
+		memset(jobs, 0, sizeof(jobs));
+		test_job_clock = 0;
+
+		JobHandle handles[TEST_SCHED_JOBS];
+		handles[a] = schedule_job(&scheduler, test_job, &jobs[a], NULL, 0);
+		handles[b] = schedule_job(&scheduler, test_job, &jobs[b], NULL, 0);
+		handles[c] = schedule_job(&scheduler, test_job, &jobs[c], handles, 2);
+		// Each fan-out job also waits on the one before, so it already has an unfinished
+		// dependency registered when it reaches c's full list
+		handles[fanout] = schedule_job(&scheduler, test_job, &jobs[fanout], &handles[c], 1);
+		for (int i = fanout + 1; i < chain; i++) {
+			JobHandle deps[2] = { handles[i - 1], handles[c] };
+			handles[i] = schedule_job(&scheduler, test_job, &jobs[i], deps, 2);
+		}
+		for (int i = chain; i < TEST_SCHED_JOBS; i++) {
+			handles[i] = schedule_job(&scheduler, test_job, &jobs[i], &handles[i - 1], 1);
+		}
+
+		wait_job(&scheduler, handles[c]);
+		bool failed = jobs[a].runs != 1 || jobs[b].runs != 1 || jobs[c].runs != 1;
+		finish_frame(&scheduler);
+
+		for (int i = 0; i < TEST_SCHED_JOBS; i++) {
+			if (jobs[i].runs != 1) failed = true;
+		}
+		if (jobs[c].stamp < jobs[a].stamp || jobs[c].stamp < jobs[b].stamp) failed = true;
+		for (int i = fanout; i < chain; i++) {
+			if (jobs[i].stamp < jobs[c].stamp || (i > fanout && jobs[i].stamp < jobs[i - 1].stamp)) failed = true;
+		}
+		for (int i = chain; i < TEST_SCHED_JOBS; i++) {
+			if (jobs[i].stamp < jobs[i - 1].stamp) failed = true;
+		}
+
+		if (failed) {
+			printf("frame %d: runs/order:", frame);
+			for (int i = 0; i < TEST_SCHED_JOBS; i++) printf(" %d/%d", jobs[i].runs, jobs[i].stamp);
+			printf("\n");
+			failures++;
+		}
+	}
+
+	scheduler_shutdown(&scheduler);
+	sched_mutex_destroy(&test_job_lock);
+	printf("%s\n", failures ? "scheduler test FAILED" : "scheduler test passed");
+	return failures ? 1 : 0;
+}
+
+
+void update_score_popups(float dt){
+	for (int i = 0; i < MAX_SCORE_POPUPS; i++){
+		if (score_popups[i].active){
+			score_popups[i].lifetime -= dt;
+			score_popups[i].position.y -= 30 * dt;
+			score_popups[i].alpha -= 1.0f * dt;
+			if (score_popups[i].lifetime <= 0.0f) {
+				score_popups[i].active = false;
+			}
+		}
+	}
+}
+
+// Job entry points. Frame-time jobs get a pointer to this frame's dt.
+void update_particles_job(void *arg) { update_particles(*(float *)arg); }
+void update_score_popups_job(void *arg) { update_score_popups(*(float *)arg); }
+void save_high_score_job(void *arg) { (void)arg; save_high_score(); }
+
+void find_hint_horizontal_job(void *arg){
+	HintSearch *h = arg;
+	h->found = find_hint_horizontal(h->tiles, h->found_tiles);
+}
+
+void find_hint_vertical_job(void *arg){
+	HintSearch *h = arg;
+	h->found = find_hint_vertical(h->tiles, h->found_tiles);
+}
+
+// Horizontal swaps win, same order as a sequential search
+void pick_hint_job(void *arg){
+	(void)arg;
+	hint_active = false;
+	for (int i = 0; i < 2; i++) {
+		if (hint_searches[i].found) {
+			hint_tiles[0] = hint_searches[i].found_tiles[0];
+			hint_tiles[1] = hint_searches[i].found_tiles[1];
+			hint_active = true;
+			break;
+		}
+	}
+}
+
+void draw_board(const GameBoard *b, bool show_hint){
+        DrawRectangle(
+            b->origin.x,
+            b->origin.y,
+            BOARD_SIZE* TILE_SIZE,
+            BOARD_SIZE* TILE_SIZE,
+            Fade(DARKGRAY, 0.60f)
+        );
+
+        for (int y = 0; y < BOARD_SIZE; y++) {
+            for (int x = 0; x < BOARD_SIZE; x++) {
+                Vector2 draw_pos = {
+                    b->origin.x + (x * TILE_SIZE),
+                    b->origin.y + (y * TILE_SIZE) - b->fall_offset[y][x]
+                };
+
+                // If swapping, interpolate positions
+                if (b->state == STATE_SWAPPING) {
+                    if (b->swap_from.x == x && b->swap_from.y == y) {
+                        draw_pos.x = b->origin.x + (b->swap_from.x + (b->swap_to.x - b->swap_from.x) * b->swap_progress) * TILE_SIZE;
+                        draw_pos.y = b->origin.y + (b->swap_from.y + (b->swap_to.y - b->swap_from.y) * b->swap_progress) * TILE_SIZE;
+                    } else if (b->swap_to.x == x && b->swap_to.y == y) {
+                        draw_pos.x = b->origin.x + (b->swap_to.x + (b->swap_from.x - b->swap_to.x) * (1 - b->swap_progress)) * TILE_SIZE;
+                        draw_pos.y = b->origin.y + (b->swap_to.y + (b->swap_from.y - b->swap_to.y) * (1 - b->swap_progress)) * TILE_SIZE;
+                    }
+                }
+
+                Rectangle rect = { draw_pos.x, draw_pos.y, TILE_SIZE, TILE_SIZE };
+                DrawRectangleLinesEx(rect, 1, DARKGRAY);
+
+                // Hint system
+                if (show_hint && hint_active) {
+                    for (int h = 0; h < 2; h++) {
+                        if ((int)hint_tiles[h].x == x && (int)hint_tiles[h].y == y) {
+                            DrawRectangleRec(rect, Fade(YELLOW, 0.25f));
+                        }
+                    }
+                }
+
+                // Wrong move red overlay
+                if (b->wrong_move &&
+                    ((x == (int)b->wrong_move_from.x && y == (int)b->wrong_move_from.y) ||
+                     (x == (int)b->wrong_move_to.x && y == (int)b->wrong_move_to.y))) {
+                    DrawRectangleRec(rect, Fade(RED, 0.6f));
+                }
+
+                DrawTextEx(GetFontDefault(),
+                    TextFormat("%c", b->tiles[y][x]),
+                    (Vector2){ rect.x + 12, rect.y + 8 },
+                    20,
+                    1,
+                    b->tiles[y][x] == GARBAGE_TILE ? GRAY : b->matched[y][x] ? GREEN : PINK
+                );
+            }
+        }
+
+        // Draw selected tile
+        if (b->selected_tile.x >= 0) {
+            DrawRectangleLinesEx((Rectangle){
+                b->origin.x + (b->selected_tile.x * TILE_SIZE),
+                b->origin.y + (b->selected_tile.y * TILE_SIZE),
+                TILE_SIZE, TILE_SIZE
+            }, 2, YELLOW);
+        }
+}
+
+// Tile under a screen position, or no_input if outside the board
+PlayerInput tile_at(const GameBoard *b, Vector2 pos){
+	int x = (pos.x - b->origin.x) / TILE_SIZE;
+	int y = (pos.y - b->origin.y) / TILE_SIZE;
+	if (pos.x < b->origin.x || pos.y < b->origin.y || x >= BOARD_SIZE || y >= BOARD_SIZE) return no_input;
+	return (PlayerInput){ x, y };
+}
+
 float intro_timer = 0.0f; // Timer for intro screen
 #define INTRO_DURATION 5.0f // 5 seconds
 
-int main(void) {
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--test-versus") == 0) {
+        return test_versus(20, 3000);
+    }
+    if (argc > 1 && strcmp(argv[1], "--test-scheduler") == 0) {
+        return test_scheduler(20000);
+    }
+
     const int screenWidth = 800;
     const int screenHeight = 450;
 
@@ -279,21 +1206,31 @@ int main(void) {
 
 	PlayMusicStream(background_music);
 
-    init_board();
-    post_intro_state = tile_state; // Save the state set by init_board
+    int grid_size = BOARD_SIZE * TILE_SIZE;
+    init_board(&player, (uint32_t)time(NULL), (Vector2){
+        (GetScreenWidth() - grid_size) / 2,
+        (GetScreenHeight() - grid_size) / 2
+    });
     Vector2 mouse = {0, 0};
     load_high_score();
+    scheduler_init(&scheduler);
 
-    tile_state = STATE_INTRO; // Start with intro screen
+    game_mode = MODE_INTRO; // Start with intro screen
     intro_timer = 0.0f;
     Rectangle musicButton = { 20, 70, 120, 36 };
+    Rectangle versusMusicButton = { 340, 4, 120, 28 }; // Top centre, clear of both boards
+
+    float sim_accumulator = 0.0f;
+    PlayerInput pending_click = no_input; // Held until a simulation step consumes it
+    PlayerInput pending_p2 = no_input;
+    Vector2 p2_cursor = { 0, 0 }; // Keyboard cursor of player 2 in versus mode
 
     while(!WindowShouldClose()){
 
 		UpdateMusicStream(background_music); // Update music stream
 
         // Intro screen
-        if (tile_state == STATE_INTRO) {
+        if (game_mode == MODE_INTRO) {
             intro_timer += GetFrameTime();
             BeginDrawing();
             ClearBackground(BLACK);
@@ -305,111 +1242,75 @@ int main(void) {
                 font_size, 1.0f, YELLOW);
             EndDrawing();
             if (intro_timer >= INTRO_DURATION) {
-                tile_state = post_intro_state; // Restore the state set by init_board
+                game_mode = MODE_SOLO;
             }
             continue; // Skip rest of loop while in intro
         }
 
-        // update game logic
-        mouse = GetMousePosition();
-        if (tile_state == STATE_IDLE && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            int x = (mouse.x - grid_origin.x) / TILE_SIZE;
-            int y = (mouse.y - grid_origin.y) / TILE_SIZE;
-
-            if (x >= 0 && x < BOARD_SIZE && y >= 0 && y < BOARD_SIZE) {
-                Vector2 current_tile = (Vector2){ x, y };
-				if (selected_tile.x < 0) {
-					selected_tile = current_tile;
-				}
-				else {
-					if (are_tiles_adjacent(selected_tile, current_tile)) {
-						swap_from = selected_tile;
-						swap_to = current_tile;
-						swap_progress = 0.0f;
-						tile_state = STATE_SWAPPING;
-					}
-					selected_tile = (Vector2){-1, -1};
-					
-				}
+        // Toggle local versus mode
+        if (IsKeyPressed(KEY_V)) {
+            if (game_mode == MODE_SOLO) {
+                start_versus((uint32_t)time(NULL));
+                game_mode = MODE_VERSUS;
+            } else {
+                game_mode = MODE_SOLO;
             }
+            sim_accumulator = 0.0f;
+            pending_click = pending_p2 = no_input;
         }
-		
-		// Handle swap animation
-		if (tile_state == STATE_SWAPPING) {
-			swap_progress += GetFrameTime() / SWAP_DURATION;
-			if (swap_progress >= 1.0f) {
-				swap_tiles(swap_from.x, swap_from.y, swap_to.x, swap_to.y);
-				if (find_matches()) {
-					resolve_matches();
-				} else {
-					swap_tiles(swap_from.x, swap_from.y, swap_to.x, swap_to.y); // Swap back if no match
-					// Set wrong move warning
-					wrong_move = true;
-					wrong_move_timer = WRONG_MOVE_DURATION;
-					wrong_move_from = swap_from;
-					wrong_move_to = swap_to;
-					tile_state = STATE_IDLE;
-				}
-				swap_from = swap_to = (Vector2){-1, -1};
-			}
-		}
 
-        // Update particles
-        update_particles(GetFrameTime());
+        // update game logic
+        mouse = GetMousePosition();
+        GameBoard *input_board = game_mode == MODE_VERSUS ? &peers[0].state.boards[0] : &player;
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+            PlayerInput click = tile_at(input_board, mouse);
+            if (click.x >= 0) pending_click = click;
+        }
 
-        // Wrong move
-        if (wrong_move) {
-            wrong_move_timer -= GetFrameTime();
-            if (wrong_move_timer <= 0.0f) {
-                wrong_move = false;
+        if (game_mode == MODE_VERSUS) {
+            if (IsKeyPressed(KEY_LEFT) && p2_cursor.x > 0) p2_cursor.x--;
+            if (IsKeyPressed(KEY_RIGHT) && p2_cursor.x < BOARD_SIZE - 1) p2_cursor.x++;
+            if (IsKeyPressed(KEY_UP) && p2_cursor.y > 0) p2_cursor.y--;
+            if (IsKeyPressed(KEY_DOWN) && p2_cursor.y < BOARD_SIZE - 1) p2_cursor.y++;
+            if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_SPACE)) {
+                pending_p2 = (PlayerInput){ p2_cursor.x, p2_cursor.y };
             }
         }
 
-		if (tile_state == STATE_ANIMATING) {
-			bool still_animating = false;
-			for (int y = 0; y < BOARD_SIZE; y++){
-				for (int x = 0; x < BOARD_SIZE; x++){
-					if (fall_offset[y][x] > 0){
-						fall_offset[y][x] -= fall_speed; // Decrease fall offset
-						if (fall_offset[y][x] < 0) {
-							fall_offset[y][x] = 0; // Reset to zero if it falls below
-						} else {
-							still_animating = true; // Still animating
-						}
-					}
-				}
-			}
-
-			if (!still_animating) {
-				tile_state = STATE_MATCH_DELAY; // Move to match delay state
-				match_delay_timer = MATCH_DELAY_DURATION;
-				}
-		}
-		  if (tile_state == STATE_MATCH_DELAY) {
-			match_delay_timer -= GetFrameTime();
-			if( match_delay_timer <= 0) {
-				if(find_matches()){
-					resolve_matches();
-				} else {
-					tile_state = STATE_IDLE; // Go back to idle state if no matches found
-				}
-			}
-		  }
-		
-		  // update score popups array
-		  for (int i = 0; i < MAX_SCORE_POPUPS; i++){
-			if (score_popups[i].active){
-				score_popups[i].lifetime -= GetFrameTime();
-				score_popups[i].position.y -= 30 * GetFrameTime();
-				score_popups[i].alpha -= 1.0f * GetFrameTime();
-				if (score_popups[i].lifetime <= 0.0f) {
-					score_popups[i].active = false;
-				}
-			}
-		  }
+        // Run the simulation in fixed steps so it is independent of the frame rate
+        sim_accumulator += GetFrameTime();
+        for (int step = 0; step < MAX_SIM_STEPS && sim_accumulator >= SIM_DT; step++) {
+            sim_accumulator -= SIM_DT;
+            if (game_mode == MODE_VERSUS) {
+                loopback_tick(&links[0]);
+                loopback_tick(&links[1]);
+                if (rollback_advance(&peers[0], pending_click)) pending_click = no_input;
+                // Peer 1 stands in for the other machine, its effects are not ours to show
+                sim_effects = false;
+                if (rollback_advance(&peers[1], pending_p2)) pending_p2 = no_input;
+                sim_effects = true;
+
+                // Both peers must agree on every fully confirmed frame
+                int confirmed = (peers[0].remote_frame < peers[1].remote_frame ? peers[0].remote_frame : peers[1].remote_frame) + 1;
+                uint32_t sum0, sum1;
+                if (rollback_confirmed_checksum(&peers[0], confirmed, &sum0) &&
+                    rollback_confirmed_checksum(&peers[1], confirmed, &sum1) &&
+                    sum0 != sum1) {
+                    desync = true;
+                }
+            } else {
+                step_board(&player, pending_click);
+                pending_click = no_input;
+            }
+        }
+        if (sim_accumulator > SIM_DT) sim_accumulator = SIM_DT; // Drop time we couldn't catch up on
 
+        // Frame update work runs on the workers while the main thread builds the draw list
+        float frame_dt = GetFrameTime();
+        JobHandle particles_job = schedule_job(&scheduler, update_particles_job, &frame_dt, NULL, 0);
+        JobHandle popups_job = schedule_job(&scheduler, update_score_popups_job, &frame_dt, NULL, 0);
 
-		  // update score animation
+		  // update score animation, too small to be worth a job
 		  if(score_animating){
 			score_scale += score_scale_velocity * GetFrameTime();
 			if (score_scale <= 1.0f){
@@ -418,109 +1319,86 @@ int main(void) {
 			}
 		  }
 
-        BeginDrawing();
-        ClearBackground(BLACK);
-
-        // Draw background
-        DrawTexturePro(background, (Rectangle){0,0, background.width, background.height},
-                       (Rectangle){0, 0, GetScreenWidth(), GetScreenHeight()}, 
-                       (Vector2){0, 0}, 0.0f, WHITE);
-
-        DrawRectangle(
-            grid_origin.x,
-            grid_origin.y,
-            BOARD_SIZE* TILE_SIZE,
-            BOARD_SIZE* TILE_SIZE,
-            Fade(DARKGRAY, 0.60f)
-        );
-
-        draw_particles(); // Draw particles before tiles
-        // --- HINT SYSTEM: Update hint logic (should only be here, outside the tile drawing loop) ---
-        if (tile_state == STATE_IDLE) {
+        // --- HINT SYSTEM: Update hint logic ---
+        JobHandle hint_job = -1;
+        if (game_mode == MODE_SOLO && player.state == STATE_IDLE) {
             idle_timer += GetFrameTime();
-            if (idle_timer >= HINT_IDLE_DURATION && !hint_active) {
-                if (find_hint(hint_tiles)) {
-                    hint_active = true;
-                } else {
-                    hint_active = false;
-                }
-            }
             // Reset hint if player interacts
             if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
                 idle_timer = 0.0f;
                 hint_active = false;
             }
+            if (idle_timer >= HINT_IDLE_DURATION && !hint_active) {
+                JobHandle searches[2];
+                for (int i = 0; i < 2; i++) {
+                    memcpy(hint_searches[i].tiles, player.tiles, sizeof(player.tiles));
+                }
+                searches[0] = schedule_job(&scheduler, find_hint_horizontal_job, &hint_searches[0], NULL, 0);
+                searches[1] = schedule_job(&scheduler, find_hint_vertical_job, &hint_searches[1], NULL, 0);
+                hint_job = schedule_job(&scheduler, pick_hint_job, NULL, searches, 2);
+            }
         } else {
             idle_timer = 0.0f;
             hint_active = false;
         }
 
-        for (int y = 0; y < BOARD_SIZE; y++) {
-            for (int x = 0; x < BOARD_SIZE; x++) {
-                Vector2 draw_pos = {
-                    grid_origin.x + (x * TILE_SIZE),
-                    grid_origin.y + (y * TILE_SIZE) - fall_offset[y][x]
-                };
-
-                // If swapping, interpolate positions
-                if (tile_state == STATE_SWAPPING) {
-                    if (swap_from.x == x && swap_from.y == y) {
-                        draw_pos.x = grid_origin.x + (swap_from.x + (swap_to.x - swap_from.x) * swap_progress) * TILE_SIZE;
-                        draw_pos.y = grid_origin.y + (swap_from.y + (swap_to.y - swap_from.y) * swap_progress) * TILE_SIZE;
-                    } else if (swap_to.x == x && swap_to.y == y) {
-                        draw_pos.x = grid_origin.x + (swap_to.x + (swap_from.x - swap_to.x) * (1 - swap_progress)) * TILE_SIZE;
-                        draw_pos.y = grid_origin.y + (swap_to.y + (swap_from.y - swap_to.y) * (1 - swap_progress)) * TILE_SIZE;
-                    }
-                }
+		if (player.score > high_score) {
+		high_score = player.score;
+		schedule_job(&scheduler, save_high_score_job, NULL, NULL, 0);
+		}
 
-                Rectangle rect = { draw_pos.x, draw_pos.y, TILE_SIZE, TILE_SIZE };
-                DrawRectangleLinesEx(rect, 1, DARKGRAY);
+        BeginDrawing();
+        ClearBackground(BLACK);
 
-                // Hint system
-                if (hint_active) {
-                    for (int h = 0; h < 2; h++) {
-                        if ((int)hint_tiles[h].x == x && (int)hint_tiles[h].y == y) {
-                            DrawRectangleRec(rect, Fade(YELLOW, 0.25f));
-                        }
-                    }
-                }
+        // Draw background
+        DrawTexturePro(background, (Rectangle){0,0, background.width, background.height},
+                       (Rectangle){0, 0, GetScreenWidth(), GetScreenHeight()},
+                       (Vector2){0, 0}, 0.0f, WHITE);
 
-                // Wrong move red overlay
-                if (wrong_move && 
-                    ((x == (int)wrong_move_from.x && y == (int)wrong_move_from.y) ||
-                     (x == (int)wrong_move_to.x && y == (int)wrong_move_to.y))) {
-                    DrawRectangleRec(rect, Fade(RED, 0.6f));
+        wait_job(&scheduler, particles_job);
+        draw_particles(); // Draw particles before tiles
+        wait_job(&scheduler, hint_job);
+
+        if (game_mode == MODE_VERSUS) {
+            // Peer 0 is this machine's view of the match
+            for (int i = 0; i < 2; i++) {
+                const GameBoard *b = &peers[0].state.boards[i];
+                draw_board(b, false);
+                DrawTextEx(score_font,
+                           TextFormat("P%d: %d", i + 1, b->score),
+                           (Vector2){ b->origin.x, b->origin.y - 40 },
+                           SCORE_FONT_SIZE * 0.8f, 1.0f, SKYBLUE);
+                if (b->garbage_in > 0) {
+                    DrawText(TextFormat("Incoming: %d", b->garbage_in),
+                             b->origin.x + BOARD_SIZE * TILE_SIZE - 110, b->origin.y - 30, 16, RED);
                 }
-
-                DrawTextEx(GetFontDefault(),
-                    TextFormat("%c", board[y][x]),
-                    (Vector2){ rect.x + 12, rect.y + 8 },
-                    20,
-                    1,
-                    matched[y][x] ? GREEN : PINK
-                );
             }
-        }
-
-        // Draw selected tile
-        if (selected_tile.x >= 0) {
+            const GameBoard *b2 = &peers[0].state.boards[1];
             DrawRectangleLinesEx((Rectangle){
-                grid_origin.x + (selected_tile.x * TILE_SIZE),
-                grid_origin.y + (selected_tile.y * TILE_SIZE),
+                b2->origin.x + (p2_cursor.x * TILE_SIZE),
+                b2->origin.y + (p2_cursor.y * TILE_SIZE),
                 TILE_SIZE, TILE_SIZE
-            }, 2, YELLOW);
+            }, 2, SKYBLUE);
+            DrawText(TextFormat("Rollbacks: %d  Last: %d frames", peers[0].rollbacks, peers[0].resimulated),
+                     20, screenHeight - 24, 16, LIGHTGRAY);
+            if (desync) {
+                DrawText("DESYNC", screenWidth - 100, screenHeight - 24, 20, RED);
+            }
+        } else {
+            draw_board(&player, true);
+
+            DrawTextEx(score_font,
+                       TextFormat("Score: %d", player.score),
+                       (Vector2){20, 20},
+                       SCORE_FONT_SIZE * score_scale, 1.0f, SKYBLUE);
+            DrawTextEx(score_font,
+                       TextFormat("High Score: %d", high_score),
+                       (Vector2){20, 120},
+                       SCORE_FONT_SIZE * 0.7f, 1.0f, DARKBLUE);
         }
 
-        DrawTextEx(score_font, 
-                   TextFormat("Score: %d", score), 
-                   (Vector2){20, 20}, 
-                   SCORE_FONT_SIZE * score_scale, 1.0f, SKYBLUE);
-        DrawTextEx(score_font, 
-                   TextFormat("High Score: %d", high_score), 
-                   (Vector2){20, 120}, 
-                   SCORE_FONT_SIZE * 0.7f, 1.0f, DARKBLUE);
-
 			// draw score popups
+			wait_job(&scheduler, popups_job);
 			for (int i = 0; i < MAX_SCORE_POPUPS; i++){
 				if (score_popups[i].active){
 					Color c = Fade(PURPLE, score_popups[i].alpha);
@@ -533,13 +1411,14 @@ int main(void) {
 			}
 
 
-		DrawRectangleRec(musicButton, music_on ? BLUE : DARKGRAY);
-        DrawRectangleLinesEx(musicButton, 2, PURPLE);
-        DrawText(music_on ? "Music: ON" : "Music: OFF", musicButton.x + 7, musicButton.y + 8, 20, WHITE);
-        
+        Rectangle button = game_mode == MODE_VERSUS ? versusMusicButton : musicButton;
+		DrawRectangleRec(button, music_on ? BLUE : DARKGRAY);
+        DrawRectangleLinesEx(button, 2, PURPLE);
+        DrawText(music_on ? "Music: ON" : "Music: OFF", button.x + 7, button.y + (button.height - 20) / 2, 20, WHITE);
+
 		// Music toggle button
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) &&
-            CheckCollisionPointRec(mouse, musicButton)) {
+            CheckCollisionPointRec(mouse, button)) {
             music_on = !music_on;
             if (music_on) {
                 PlayMusicStream(background_music);
@@ -547,16 +1426,12 @@ int main(void) {
                 PauseMusicStream(background_music);
             }
         }
-		
 
-		if (score > high_score) {
-		high_score = score;
-		save_high_score();
-		}
-	
+
         // Draw score
         //DrawText(TextFormat("Score: %d", score), 20, 20, 24, YELLOW);
         EndDrawing();
+        finish_frame(&scheduler);
     }
 
 	StopMusicStream(background_music); // Stop music stream
@@ -567,6 +1442,7 @@ int main(void) {
 
 	CloseAudioDevice();
 
+    scheduler_shutdown(&scheduler);
     save_high_score(); // Ensure high score is saved on exit
 
     CloseWindow(); // Close window and OpenGL context
@@ -627,7 +1503,7 @@ void draw_particles(void) {
 
 
 
-bool find_hint(Vector2 out_tiles[2]) {
+bool find_hint_horizontal(char board[BOARD_SIZE][BOARD_SIZE], Vector2 out_tiles[2]) {
     // Check for possible horizontal swaps
     for (int y = 0; y < BOARD_SIZE; y++) {
         for (int x = 0; x < BOARD_SIZE - 1; x++) {
@@ -639,7 +1515,7 @@ bool find_hint(Vector2 out_tiles[2]) {
             for (int i = 0; i < BOARD_SIZE; i++) {
                 for (int j = 0; j < BOARD_SIZE - 2; j++) {
                     char t = board[i][j];
-                    if (t == board[i][j+1] && t == board[i][j+2]) {
+                    if (is_matchable(t) && t == board[i][j+1] && t == board[i][j+2]) {
                         // Found a match, so the swap (x,y) <-> (x+1,y) is a valid move
                         out_tiles[0] = (Vector2){x, y};
                         out_tiles[1] = (Vector2){x+1, y};
@@ -657,6 +1533,10 @@ bool find_hint(Vector2 out_tiles[2]) {
             board[y][x+1] = temp;
         }
     }
+    return false;
+}
+
+bool find_hint_vertical(char board[BOARD_SIZE][BOARD_SIZE], Vector2 out_tiles[2]) {
     // Check for possible vertical swaps
     for (int x = 0; x < BOARD_SIZE; x++) {
         for (int y = 0; y < BOARD_SIZE - 1; y++) {
@@ -667,7 +1547,7 @@ bool find_hint(Vector2 out_tiles[2]) {
             // Check for match
             for (int i = 0; i < BOARD_SIZE - 2; i++) {
                 char t = board[i][x];
-                if (t == board[i+1][x] && t == board[i+2][x]) {
+                if (is_matchable(t) && t == board[i+1][x] && t == board[i+2][x]) {
                     // Found a match, so the swap (x,y) <-> (x,y+1) is a valid move
                     out_tiles[0] = (Vector2){x, y};
                     out_tiles[1] = (Vector2){x, y+1};
@@ -685,4 +1565,4 @@ bool find_hint(Vector2 out_tiles[2]) {
         }
     }
     return false;
-}
\ No newline at end of file
+}